@@ -0,0 +1,103 @@
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#include "server.h"
+
+/**
+ * Quiet batch-apply driver for server.h.
+ *
+ * It reads the same input as basic.cpp (the map followed by "row column type" operations), but does not print the map
+ * after every operation. Output is produced only at checkpoints and when the game ends, so replaying or validating long
+ * move logs is no longer dominated by rendering.
+ *
+ * Usage: server_batch [--every N] [--hash]
+ *   --every N  print a checkpoint after every N applied operations (0, the default, disables periodic checkpoints)
+ *   --hash     print a "HASH <hex>" line describing the current state at every checkpoint and at the end
+ *
+ * Besides the operation types 0, 1 and 2 of basic.cpp, type 3 requests a checkpoint explicitly (its coordinates are
+ * ignored). A checkpoint prints the map exactly as PrintMap() does. When the game ends, the final map and the result of
+ * ExitGame() are printed. If the input runs out before the game ends, the final map is printed as a checkpoint unless it
+ * has just been printed.
+ */
+
+/**
+ * Calculate a 64-bit FNV-1a hash of the visible state: the map as PrintMap() shows it, followed by game_state.
+ */
+uint64_t StateHash() {
+  const uint64_t kPrime = 1099511628211ULL;
+  uint64_t hash = 14695981039346656037ULL;
+  for (int i = 0; i < rows; i++) {
+    for (int j = 0; j < columns; j++) {
+      char shown = (game_state == 1 && game_map[i][j] == 'X') ? '@' : display_map[i][j];
+      hash = (hash ^ static_cast<unsigned char>(shown)) * kPrime;
+    }
+  }
+  hash = (hash ^ static_cast<uint64_t>(game_state + 1)) * kPrime;
+  return hash;
+}
+
+void PrintHash() {
+  std::cout << "HASH " << std::hex << std::setw(16) << std::setfill('0') << StateHash() << std::dec << std::setfill(' ')
+            << '\n';
+}
+
+void Checkpoint(bool with_hash) {
+  PrintMap();
+  if (with_hash) {
+    PrintHash();
+  }
+}
+
+int main(int argc, char *argv[]) {
+  long long every = 0;
+  bool with_hash = false;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--every") == 0 && i + 1 < argc) {
+      every = std::atoll(argv[++i]);
+    } else if (std::strcmp(argv[i], "--hash") == 0) {
+      with_hash = true;
+    } else {
+      std::cerr << "Usage: " << argv[0] << " [--every N] [--hash]" << std::endl;
+      return 1;
+    }
+  }
+
+  std::ios::sync_with_stdio(false);
+  std::cin.tie(nullptr);
+
+  InitMap();
+  long long applied = 0;
+  bool pending = true;  // Whether the current state has not been printed since the last operation
+  int pos_x, pos_y, type;
+  while (std::cin >> pos_x >> pos_y >> type) {
+    if (type == 3) {
+      Checkpoint(with_hash);
+      pending = false;
+      continue;
+    }
+    if (type == 0) {
+      VisitBlock(pos_x, pos_y);
+    } else if (type == 1) {
+      MarkMine(pos_x, pos_y);
+    } else if (type == 2) {
+      AutoExplore(pos_x, pos_y);
+    }
+    ++applied;
+    pending = true;
+    if (game_state != 0) {
+      Checkpoint(with_hash);
+      ExitGame();
+    }
+    if (every > 0 && applied % every == 0) {
+      Checkpoint(with_hash);
+      pending = false;
+    }
+  }
+  if (pending) {
+    Checkpoint(with_hash);
+  }
+  return 0;
+}
@@ -1,8 +1,22 @@
 #ifndef CLIENT_H
 #define CLIENT_H
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
 #include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 extern int rows;         // The count of rows of the game map.
 extern int columns;      // The count of columns of the game map.
@@ -11,18 +25,40 @@ extern int total_mines;  // The count of mines of the game map.
 // You MUST NOT use any other external variables except for rows, columns and total_mines.
 
 // Client game state variables
-char** client_map;    // Current map state from ReadMap()
-bool** client_safe;   // Grids that are known to be safe
-bool** client_mine;   // Grids that are known to be mines
-bool** client_visited;// Grids that have been visited
-bool** client_marked; // Grids that have been marked
+// The whole visible map lives in one byte per grid, row-major: '?' for unknown, '0'-'8' for a visited number, '@' for a
+// marked mine and 'X' for a visited mine or a wrong mark.
+std::vector<char> client_grid;
 int client_unvisited_count;  // Count of unvisited grids
+int client_marked_count;     // Count of marked grids
+std::mt19937_64 client_rng;  // Random source of the client, seeds the sampler threads
 
 // Helper function to check if coordinates are valid
 bool IsValidClient(int r, int c) {
   return r >= 0 && r < rows && c >= 0 && c < columns;
 }
 
+// Helper functions to read the state of a grid
+char ClientCell(int r, int c) {
+  return client_grid[r * columns + c];
+}
+
+bool IsVisitedClient(int r, int c) {
+  char cell = client_grid[r * columns + c];
+  return cell != '?' && cell != '@';
+}
+
+bool IsMarkedClient(int r, int c) {
+  return client_grid[r * columns + c] == '@';
+}
+
+// Write a grid of the visible map and keep the counters up to date
+void WriteClientCell(int id, char value) {
+  char old_value = client_grid[id];
+  client_unvisited_count += (value == '?') - (old_value == '?');
+  client_marked_count += (value == '@') - (old_value == '@');
+  client_grid[id] = value;
+}
+
 // Helper function to count unvisited neighbors
 int CountUnvisitedNeighbors(int r, int c) {
   int count = 0;
@@ -30,7 +66,7 @@ int CountUnvisitedNeighbors(int r, int c) {
     for (int dc = -1; dc <= 1; dc++) {
       if (dr == 0 && dc == 0) continue;
       int nr = r + dr, nc = c + dc;
-      if (IsValidClient(nr, nc) && !client_visited[nr][nc] && !client_marked[nr][nc]) {
+      if (IsValidClient(nr, nc) && !IsVisitedClient(nr, nc) && !IsMarkedClient(nr, nc)) {
         count++;
       }
     }
@@ -45,7 +81,7 @@ int CountMarkedNeighbors(int r, int c) {
     for (int dc = -1; dc <= 1; dc++) {
       if (dr == 0 && dc == 0) continue;
       int nr = r + dr, nc = c + dc;
-      if (IsValidClient(nr, nc) && client_marked[nr][nc]) {
+      if (IsValidClient(nr, nc) && IsMarkedClient(nr, nc)) {
         count++;
       }
     }
@@ -53,66 +89,1359 @@ int CountMarkedNeighbors(int r, int c) {
   return count;
 }
 
-// Helper function to find a safe move
-bool FindSafeMove(int& safe_r, int& safe_c) {
+// Helper function to find a random unvisited cell
+bool FindRandomUnvisited(int& r, int& c) {
   for (int i = 0; i < rows; i++) {
     for (int j = 0; j < columns; j++) {
-      if (client_visited[i][j] && client_map[i][j] >= '1' && client_map[i][j] <= '8') {
-        int number = client_map[i][j] - '0';
-        int marked_count = CountMarkedNeighbors(i, j);
-        int unvisited_count = CountUnvisitedNeighbors(i, j);
-
-        // If number equals marked + unvisited, all unvisited are mines
-        if (number == marked_count + unvisited_count) {
-          for (int dr = -1; dr <= 1; dr++) {
-            for (int dc = -1; dc <= 1; dc++) {
-              if (dr == 0 && dc == 0) continue;
-              int nr = i + dr, nc = j + dc;
-              if (IsValidClient(nr, nc) && !client_visited[nr][nc] && !client_marked[nr][nc]) {
-                // Mark this as mine
-                safe_r = nr;
-                safe_c = nc;
-                return true;
-              }
-            }
+      if (!IsVisitedClient(i, j) && !IsMarkedClient(i, j)) {
+        r = i;
+        c = j;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/*
+ * Local pattern table.
+ * Two visited numbers side by side see a 3 x 4 window (4 x 3 when one is above the other). Besides the two numbers the
+ * window holds ten grids: three seen only by the first number, four seen by both and three seen only by the second. A
+ * pattern packs the mask of the unknown grids among those ten with the mines each number still misses, and
+ * kPatternTable maps it to the grids that are forced safe or forced mines. The table is computed at compile time, so a
+ * lookup is a single array access.
+ */
+
+// Window grids of a pair, as (row, column) offsets from the first number when the second one is on its right. Grids
+// 0-2 are seen only by the first number, 3-6 by both, 7-9 only by the second. When the second number is below the
+// first, the offsets are transposed.
+constexpr int kPatternOffsets[10][2] = {{-1, -1}, {0, -1}, {1, -1}, {-1, 0}, {-1, 1},
+                                        {1, 0},   {1, 1},  {-1, 2}, {0, 2},  {1, 2}};
+constexpr int kPatternGroupMask[3] = {0x007, 0x078, 0x380};
+constexpr int kPatternEntries = 1024 * 81;  // Unknown mask * 81 + first number's need * 9 + second number's need
+
+constexpr int PatternPopcount(int mask) {
+  int count = 0;
+  for (; mask != 0; mask &= mask - 1) {
+    count++;
+  }
+  return count;
+}
+
+// Every entry holds the forced safe grids in bits 0-9 and the forced mines in bits 16-25
+constexpr std::array<uint32_t, kPatternEntries> BuildPatternTable() {
+  std::array<uint32_t, kPatternEntries> table{};
+  for (int mask = 0; mask < 1024; mask++) {
+    int unknown[3] = {0, 0, 0};
+    for (int group = 0; group < 3; group++) {
+      unknown[group] = PatternPopcount(mask & kPatternGroupMask[group]);
+    }
+    for (int need_a = 0; need_a <= 8; need_a++) {
+      for (int need_b = 0; need_b <= 8; need_b++) {
+        // Only the number of mines in each group matters, since the grids of a group are interchangeable
+        bool consistent = false, always_safe[3] = {true, true, true}, always_mine[3] = {true, true, true};
+        for (int only_a = 0; only_a <= unknown[0]; only_a++) {
+          int shared = need_a - only_a, only_b = need_b - shared;
+          if (shared < 0 || shared > unknown[1] || only_b < 0 || only_b > unknown[2]) continue;
+          int mines[3] = {only_a, shared, only_b};
+          consistent = true;
+          for (int group = 0; group < 3; group++) {
+            if (mines[group] != 0) always_safe[group] = false;
+            if (mines[group] != unknown[group]) always_mine[group] = false;
           }
         }
+        if (!consistent) continue;
+        uint32_t entry = 0;
+        for (int group = 0; group < 3; group++) {
+          uint32_t grids = static_cast<uint32_t>(mask & kPatternGroupMask[group]);
+          if (always_safe[group]) entry |= grids;
+          if (always_mine[group]) entry |= grids << 16;
+        }
+        table[mask * 81 + need_a * 9 + need_b] = entry;
+      }
+    }
+  }
+  return table;
+}
+
+constexpr std::array<uint32_t, kPatternEntries> kPatternTable = BuildPatternTable();
+
+// Mines still missing around a visited number
+int MissingMines(int r, int c) {
+  return ClientCell(r, c) - '0' - CountMarkedNeighbors(r, c);
+}
+
+/**
+ * Look up the pair of the visited number at (i, j) and its neighbor to the right (vertical = 0) or below (vertical = 1)
+ * in kPatternTable. If the pair forces a grid, it is returned with type 0 for a safe grid to visit or 1 for a mine to
+ * mark.
+ */
+bool FindPairMove(int i, int j, int vertical, int &r, int &c, int &type) {
+  int pi = i + vertical, pj = j + 1 - vertical;
+  if (!IsValidClient(i, j) || !IsVisitedClient(i, j) || ClientCell(i, j) < '0' || ClientCell(i, j) > '8') return false;
+  if (!IsValidClient(pi, pj) || !IsVisitedClient(pi, pj) || ClientCell(pi, pj) < '0' || ClientCell(pi, pj) > '8') {
+    return false;
+  }
+  int need_a = MissingMines(i, j), need_b = MissingMines(pi, pj);
+  if (need_a < 0 || need_a > 8 || need_b < 0 || need_b > 8) return false;
+  int mask = 0;
+  for (int k = 0; k < 10; k++) {
+    int nr = i + kPatternOffsets[k][vertical], nc = j + kPatternOffsets[k][1 - vertical];
+    if (IsValidClient(nr, nc) && !IsVisitedClient(nr, nc) && !IsMarkedClient(nr, nc)) mask |= 1 << k;
+  }
+  if (mask == 0) return false;
+  uint32_t entry = kPatternTable[mask * 81 + need_a * 9 + need_b];
+  for (int k = 0; k < 10; k++) {
+    if (entry & (0x10001u << k)) {
+      r = i + kPatternOffsets[k][vertical];
+      c = j + kPatternOffsets[k][1 - vertical];
+      type = (entry & (1u << k)) ? 0 : 1;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Frontier model of the current map. Unknown grids next to a visited number form the frontier, the other unknown
+// grids form the interior. Every visited number with unknown neighbors becomes a constraint over frontier grids.
+struct FrontierModel {
+  std::vector<int> frontier;                       // Ids (r * columns + c) of frontier grids
+  std::vector<int> interior;                       // Ids of interior grids
+  std::vector<int> frontier_index;                 // Frontier index of every id, or -1
+  std::vector<std::vector<int>> constraint_cells;  // Frontier indices around each constraint
+  std::vector<int> constraint_need;                // Mines still missing around each constraint
+  std::vector<std::vector<int>> cell_constraints;  // Constraints touching each frontier grid
+  int remaining_mines;                             // total_mines minus the marked grids
+};
 
-        // If number equals marked, all unvisited are safe
-        if (number == marked_count && unvisited_count > 0) {
-          for (int dr = -1; dr <= 1; dr++) {
-            for (int dc = -1; dc <= 1; dc++) {
-              if (dr == 0 && dc == 0) continue;
-              int nr = i + dr, nc = j + dc;
-              if (IsValidClient(nr, nc) && !client_visited[nr][nc] && !client_marked[nr][nc]) {
-                // Visit this safe cell
-                safe_r = nr;
-                safe_c = nc;
-                return true;
-              }
+// Build the frontier model from the visible map
+FrontierModel BuildFrontier() {
+  FrontierModel model;
+  model.frontier_index.assign(rows * columns, -1);
+  model.remaining_mines = total_mines - client_marked_count;
+  for (int i = 0; i < rows; i++) {
+    for (int j = 0; j < columns; j++) {
+      if (!IsVisitedClient(i, j) || ClientCell(i, j) < '0' || ClientCell(i, j) > '8') continue;
+      std::vector<int> cells;
+      int need = ClientCell(i, j) - '0';
+      for (int dr = -1; dr <= 1; dr++) {
+        for (int dc = -1; dc <= 1; dc++) {
+          if (dr == 0 && dc == 0) continue;
+          int nr = i + dr, nc = j + dc;
+          if (!IsValidClient(nr, nc)) continue;
+          if (IsMarkedClient(nr, nc)) {
+            need--;
+          } else if (!IsVisitedClient(nr, nc)) {
+            int id = nr * columns + nc;
+            if (model.frontier_index[id] < 0) {
+              model.frontier_index[id] = static_cast<int>(model.frontier.size());
+              model.frontier.push_back(id);
+              model.cell_constraints.emplace_back();
             }
+            cells.push_back(model.frontier_index[id]);
           }
         }
       }
+      if (cells.empty()) continue;
+      for (int cell : cells) {
+        model.cell_constraints[cell].push_back(static_cast<int>(model.constraint_cells.size()));
+      }
+      model.constraint_cells.push_back(cells);
+      model.constraint_need.push_back(need);
+    }
+  }
+  for (int i = 0; i < rows; i++) {
+    for (int j = 0; j < columns; j++) {
+      if (!IsVisitedClient(i, j) && !IsMarkedClient(i, j) && model.frontier_index[i * columns + j] < 0) {
+        model.interior.push_back(i * columns + j);
+      }
+    }
+  }
+  return model;
+}
+
+// Natural logarithm of the binomial coefficient C(n, k)
+double LogChoose(int n, int k) {
+  return std::lgamma(n + 1.0) - std::lgamma(k + 1.0) - std::lgamma(n - k + 1.0);
+}
+
+/*
+ * Exact reasoning.
+ * The frontier splits into components that share no constraint. Every component is enumerated by backtracking, which
+ * counts its solutions per number of mines. The counts of all components are then combined with the number of ways to
+ * place the remaining mines in the interior, which gives the exact mine probability of every unknown grid. The counts
+ * only depend on the grids of a component and on its numbers, so they are kept between calls, and a component is only
+ * enumerated again once one of them has changed.
+ */
+
+const long long kEnumerateNodeLimit = 200000;  // Search nodes one component may use before it counts as too big
+
+// Solution counts of one frontier component
+struct ComponentCount {
+  std::vector<int> cells;                       // Frontier indices, in search order
+  std::vector<double> solutions;                // solutions[k]: assignments with k mines
+  std::vector<std::vector<double>> cell_mines;  // cell_mines[k][i]: those of them in which cells[i] is a mine
+  bool complete = true;                         // false if the node limit was reached
+};
+
+// Count of a component, with the key it was computed for
+struct KeptComponent {
+  std::vector<int> key;
+  ComponentCount count;
+};
+
+// Counts of the components of the last exact reasoning, by the id of the first grid of each component
+std::unordered_map<int, KeptComponent> client_component_counts;
+
+// Everything the count of a component depends on: the ids of its grids in search order, then the need and the grid ids
+// of each of its constraints
+std::vector<int> ComponentKey(const FrontierModel &model, const std::vector<int> &cells) {
+  std::vector<int> key, constraints;
+  for (int cell : cells) {
+    key.push_back(model.frontier[cell]);
+    constraints.insert(constraints.end(), model.cell_constraints[cell].begin(), model.cell_constraints[cell].end());
+  }
+  std::sort(constraints.begin(), constraints.end());
+  constraints.erase(std::unique(constraints.begin(), constraints.end()), constraints.end());
+  for (int constraint : constraints) {
+    key.push_back(-1);
+    key.push_back(model.constraint_need[constraint]);
+    for (int cell : model.constraint_cells[constraint]) key.push_back(model.frontier[cell]);
+  }
+  return key;
+}
+
+// Split the frontier into components, each listed in breadth-first order so that constraints close early
+std::vector<std::vector<int>> SplitComponents(const FrontierModel &model) {
+  std::vector<std::vector<int>> components;
+  std::vector<bool> seen(model.frontier.size(), false);
+  for (int start = 0; start < static_cast<int>(model.frontier.size()); start++) {
+    if (seen[start]) continue;
+    std::vector<int> cells{start};
+    seen[start] = true;
+    for (int head = 0; head < static_cast<int>(cells.size()); head++) {
+      for (int constraint : model.cell_constraints[cells[head]]) {
+        for (int next : model.constraint_cells[constraint]) {
+          if (!seen[next]) {
+            seen[next] = true;
+            cells.push_back(next);
+          }
+        }
+      }
+    }
+    components.push_back(cells);
+  }
+  return components;
+}
+
+/*
+ * Worker pool shared by the parallel enumeration and the sampler.
+ * The worker threads are started the first time a job needs them and then sleep until the next job, so they live across
+ * components, calls and games instead of being created for each job. RunOnWorkers() runs job(0) on the calling thread
+ * and job(1) to job(threads - 1) on the workers, and returns once every part has finished. The workers are stopped and
+ * joined when the program exits.
+ */
+
+struct ClientWorkerPool {
+  std::vector<std::thread> workers;      // Worker t - 1 runs part t of every job
+  std::mutex mutex;
+  std::condition_variable wake;          // Signals a new job or the shutdown to the workers
+  std::condition_variable done;          // Signals the caller that the last part has finished
+  std::function<void(int)> job;
+  long long generation = 0;              // Count of jobs handed out so far
+  int parts = 0;                         // Parts of the current job, including the caller's
+  int running = 0;                       // Parts still running on the workers
+  bool stopping = false;
+
+  ~ClientWorkerPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &worker : workers) worker.join();
+  }
+};
+
+ClientWorkerPool client_pool;
+
+// Body of worker thread `self` (1-based): run part `self` of every job that has that many parts
+void RunPoolWorker(int self) {
+  long long seen = 0;
+  std::unique_lock<std::mutex> lock(client_pool.mutex);
+  while (true) {
+    client_pool.wake.wait(lock, [&] { return client_pool.stopping || client_pool.generation != seen; });
+    if (client_pool.stopping) return;
+    seen = client_pool.generation;
+    if (self >= client_pool.parts) continue;
+    lock.unlock();
+    client_pool.job(self);
+    lock.lock();
+    if (--client_pool.running == 0) client_pool.done.notify_one();
+  }
+}
+
+// Run job(0), ..., job(threads - 1) in parallel, part 0 on the calling thread, and wait until all have finished
+void RunOnWorkers(const std::function<void(int)> &job, int threads) {
+  if (threads <= 1) {
+    job(0);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(client_pool.mutex);
+    while (static_cast<int>(client_pool.workers.size()) < threads - 1) {
+      client_pool.workers.emplace_back(RunPoolWorker, static_cast<int>(client_pool.workers.size()) + 1);
+    }
+    client_pool.job = job;
+    client_pool.parts = threads;
+    client_pool.running = threads - 1;
+    client_pool.generation++;
+  }
+  client_pool.wake.notify_all();
+  job(0);
+  std::unique_lock<std::mutex> lock(client_pool.mutex);
+  client_pool.done.wait(lock, [] { return client_pool.running == 0; });
+  client_pool.job = nullptr;
+}
+
+// Number of threads to use, at most max_threads
+int ClientThreadCount(int max_threads) {
+  int threads = static_cast<int>(std::thread::hardware_concurrency());
+  return std::max(1, std::min(threads, max_threads));
+}
+
+/*
+ * Large components are enumerated in parallel. The first kSplitDepth levels of the search are expanded on the calling
+ * thread, and every feasible subtree below them becomes a task. Tasks are dealt round-robin into one queue per worker;
+ * a worker takes tasks from the back of its own queue and, once it is empty, steals from the front of the others. Every
+ * worker counts into its own ComponentCount and the counts are added up at the end. Solution counts are integers far
+ * below 2^53, so the sums are exactly those of the sequential search. The node limit also covers all workers together,
+ * so a component is complete in parallel exactly when it is complete sequentially. The workers are those of client_pool.
+ */
+
+const int kEnumerateMaxThreads = 4;
+const int kParallelMinCells = 24;           // Smaller components are enumerated on the calling thread
+const int kSplitDepth = 8;                  // Levels expanded before the subtrees are handed to the workers
+const long long kNodeFlushInterval = 4096;  // Nodes a worker counts locally before adding them to the shared count
+
+// A subtree of the search: the backtracking state at a given position
+struct EnumerateTask {
+  std::vector<char> assign;
+  std::vector<int> mines;
+  std::vector<int> unassigned;
+  int position;
+  int mine_total;
+};
+
+// Backtracking state of EnumerateComponent()
+struct EnumerateState {
+  const FrontierModel *model;
+  ComponentCount *count;
+  std::vector<char> assign;         // Assignment of count->cells, by position
+  std::vector<int> mines;           // Mines assigned around each constraint
+  std::vector<int> unassigned;      // Unassigned grids around each constraint
+  long long nodes = 0;
+  int split_depth = -1;                            // Position at which subtrees go to tasks instead of being searched
+  std::vector<EnumerateTask> *tasks = nullptr;
+  std::atomic<long long> *shared_nodes = nullptr;  // Nodes of all workers, when enumerating in parallel
+  std::atomic<bool> *aborted = nullptr;            // Set once the workers together exceed the node limit
+};
+
+ComponentCount NewComponentCount(const std::vector<int> &cells) {
+  ComponentCount count;
+  count.cells = cells;
+  count.solutions.assign(cells.size() + 1, 0);
+  count.cell_mines.assign(cells.size() + 1, std::vector<double>(cells.size(), 0));
+  return count;
+}
+
+EnumerateState NewEnumerateState(const FrontierModel &model, ComponentCount &count) {
+  EnumerateState state;
+  state.model = &model;
+  state.count = &count;
+  state.assign.assign(count.cells.size(), 0);
+  state.mines.assign(model.constraint_cells.size(), 0);
+  state.unassigned.assign(model.constraint_cells.size(), 0);
+  for (int constraint = 0; constraint < static_cast<int>(model.constraint_cells.size()); constraint++) {
+    state.unassigned[constraint] = static_cast<int>(model.constraint_cells[constraint].size());
+  }
+  return state;
+}
+
+// Count one search node. Returns false once the component has used more than kEnumerateNodeLimit nodes.
+bool CountNode(EnumerateState &state) {
+  state.nodes++;
+  if (state.shared_nodes == nullptr) return state.nodes <= kEnumerateNodeLimit;
+  if (state.nodes % kNodeFlushInterval == 0 &&
+      state.shared_nodes->fetch_add(kNodeFlushInterval) + kNodeFlushInterval > kEnumerateNodeLimit) {
+    state.aborted->store(true);
+  }
+  return !state.aborted->load(std::memory_order_relaxed);
+}
+
+// Check whether every constraint touching a frontier grid can still be satisfied
+bool ConstraintsFeasible(const EnumerateState &state, int cell) {
+  for (int constraint : state.model->cell_constraints[cell]) {
+    int need = state.model->constraint_need[constraint];
+    if (state.mines[constraint] > need || state.mines[constraint] + state.unassigned[constraint] < need) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void EnumerateFrom(EnumerateState &state, int position, int mine_total) {
+  if (!state.count->complete) return;
+  if (position == state.split_depth) {
+    state.tasks->push_back({state.assign, state.mines, state.unassigned, position, mine_total});
+    return;
+  }
+  if (!CountNode(state)) {
+    state.count->complete = false;
+    return;
+  }
+  ComponentCount &count = *state.count;
+  if (position == static_cast<int>(count.cells.size())) {
+    count.solutions[mine_total] += 1;
+    for (int i = 0; i < position; i++) {
+      if (state.assign[i]) count.cell_mines[mine_total][i] += 1;
     }
+    return;
+  }
+  int cell = count.cells[position];
+  for (int value = 0; value <= 1; value++) {
+    state.assign[position] = static_cast<char>(value);
+    for (int constraint : state.model->cell_constraints[cell]) {
+      state.unassigned[constraint]--;
+      state.mines[constraint] += value;
+    }
+    if (ConstraintsFeasible(state, cell)) {
+      EnumerateFrom(state, position + 1, mine_total + value);
+    }
+    for (int constraint : state.model->cell_constraints[cell]) {
+      state.unassigned[constraint]++;
+      state.mines[constraint] -= value;
+    }
+  }
+}
+
+struct TaskQueue {
+  std::mutex mutex;
+  std::deque<EnumerateTask> tasks;
+};
+
+// Take a task from the back of the worker's own queue, or steal one from the front of another queue
+bool TakeTask(std::vector<TaskQueue> &queues, int self, EnumerateTask &task) {
+  int count = static_cast<int>(queues.size());
+  for (int k = 0; k < count; k++) {
+    TaskQueue &queue = queues[(self + k) % count];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) continue;
+    if (k == 0) {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    } else {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+    return true;
   }
   return false;
 }
 
-// Helper function to find a random unvisited cell
-bool FindRandomUnvisited(int& r, int& c) {
-  for (int i = 0; i < rows; i++) {
-    for (int j = 0; j < columns; j++) {
-      if (!client_visited[i][j] && !client_marked[i][j]) {
-        r = i;
-        c = j;
-        return true;
+// Tasks are never created while the workers run, so a worker is done once every queue is empty
+void RunEnumerateWorker(const FrontierModel &model, std::vector<TaskQueue> &queues, int self,
+                        std::atomic<long long> &shared_nodes, std::atomic<bool> &aborted, ComponentCount &partial) {
+  EnumerateState state = NewEnumerateState(model, partial);
+  state.shared_nodes = &shared_nodes;
+  state.aborted = &aborted;
+  EnumerateTask task;
+  while (TakeTask(queues, self, task)) {
+    state.assign = std::move(task.assign);
+    state.mines = std::move(task.mines);
+    state.unassigned = std::move(task.unassigned);
+    EnumerateFrom(state, task.position, task.mine_total);
+  }
+  shared_nodes.fetch_add(state.nodes % kNodeFlushInterval);
+}
+
+// Count the solutions of one component on `threads` threads, with the same result as the sequential search
+ComponentCount EnumerateComponentParallel(const FrontierModel &model, const std::vector<int> &cells, int threads) {
+  ComponentCount count = NewComponentCount(cells);
+  std::vector<EnumerateTask> tasks;
+  EnumerateState state = NewEnumerateState(model, count);
+  state.split_depth = std::min(kSplitDepth, static_cast<int>(cells.size()));
+  state.tasks = &tasks;
+  EnumerateFrom(state, 0, 0);
+  if (!count.complete) return count;
+
+  std::vector<TaskQueue> queues(threads);
+  for (size_t t = 0; t < tasks.size(); t++) {
+    queues[t % threads].tasks.push_back(std::move(tasks[t]));
+  }
+  std::atomic<long long> shared_nodes(state.nodes);
+  std::atomic<bool> aborted(false);
+  std::vector<ComponentCount> partial(threads, NewComponentCount(cells));
+  RunOnWorkers([&](int t) { RunEnumerateWorker(model, queues, t, shared_nodes, aborted, partial[t]); }, threads);
+
+  count.complete = !aborted && shared_nodes <= kEnumerateNodeLimit;
+  if (!count.complete) return count;
+  for (const ComponentCount &part : partial) {
+    for (size_t k = 0; k < count.solutions.size(); k++) {
+      count.solutions[k] += part.solutions[k];
+      for (size_t i = 0; i < cells.size(); i++) {
+        count.cell_mines[k][i] += part.cell_mines[k][i];
+      }
+    }
+  }
+  return count;
+}
+
+// Count the solutions of one component per number of mines
+ComponentCount EnumerateComponent(const FrontierModel &model, const std::vector<int> &cells) {
+  int threads = ClientThreadCount(kEnumerateMaxThreads);
+  if (threads > 1 && static_cast<int>(cells.size()) >= kParallelMinCells) {
+    return EnumerateComponentParallel(model, cells, threads);
+  }
+  ComponentCount count = NewComponentCount(cells);
+  EnumerateState state = NewEnumerateState(model, count);
+  EnumerateFrom(state, 0, 0);
+  return count;
+}
+
+std::vector<double> Convolve(const std::vector<double> &a, const std::vector<double> &b) {
+  std::vector<double> result(a.size() + b.size() - 1, 0);
+  for (size_t i = 0; i < a.size(); i++) {
+    if (a[i] == 0) continue;
+    for (size_t j = 0; j < b.size(); j++) {
+      result[i + j] += a[i] * b[j];
+    }
+  }
+  return result;
+}
+
+// Result of the exact reasoning. Probabilities are indexed by grid id and are only meaningful for unknown grids.
+struct ExactResult {
+  bool global = false;              // Whether every component was complete, so mine_probability is exact
+  std::vector<double> mine_probability;
+  std::vector<int> safe_cells;      // Grids that are safe in every solution
+  std::vector<int> mine_cells;      // Grids that are mines in every solution
+};
+
+/**
+ * Enumerate every frontier component and combine them with the interior. If some component is too big, only the
+ * components that finished are used, and only for deductions that hold without the global mine count.
+ */
+ExactResult ReasonExactly(const FrontierModel &model) {
+  ExactResult result;
+  result.mine_probability.assign(rows * columns, -1);
+  std::vector<ComponentCount> counts;
+  std::unordered_map<int, KeptComponent> kept;
+  for (const std::vector<int> &cells : SplitComponents(model)) {
+    std::vector<int> key = ComponentKey(model, cells);
+    int first = model.frontier[cells[0]];
+    auto it = client_component_counts.find(first);
+    if (it != client_component_counts.end() && it->second.key == key) {
+      counts.push_back(std::move(it->second.count));
+      counts.back().cells = cells;  // Same grids in the same order, but their frontier indices may have moved
+    } else {
+      counts.push_back(EnumerateComponent(model, cells));
+    }
+    kept[first] = {std::move(key), counts.back()};
+  }
+  client_component_counts = std::move(kept);
+  result.global = true;
+  for (const ComponentCount &count : counts) {
+    if (!count.complete) result.global = false;
+  }
+
+  if (!result.global) {
+    for (const ComponentCount &count : counts) {
+      if (!count.complete) continue;
+      for (size_t i = 0; i < count.cells.size(); i++) {
+        bool always_safe = true, always_mine = true;
+        for (size_t k = 0; k < count.solutions.size(); k++) {
+          if (count.cell_mines[k][i] > 0) always_safe = false;
+          if (count.cell_mines[k][i] < count.solutions[k]) always_mine = false;
+        }
+        if (always_safe) result.safe_cells.push_back(model.frontier[count.cells[i]]);
+        if (always_mine) result.mine_cells.push_back(model.frontier[count.cells[i]]);
+      }
+    }
+    return result;
+  }
+
+  // interior_weight[t]: ways to place the other remaining_mines - t mines in the interior, scaled to avoid overflow
+  int interior = static_cast<int>(model.interior.size());
+  int frontier = static_cast<int>(model.frontier.size());
+  std::vector<double> interior_weight(frontier + 1, 0);
+  double max_log = -1e300;
+  for (int t = 0; t <= frontier; t++) {
+    int rest = model.remaining_mines - t;
+    if (rest >= 0 && rest <= interior) max_log = std::max(max_log, LogChoose(interior, rest));
+  }
+  for (int t = 0; t <= frontier; t++) {
+    int rest = model.remaining_mines - t;
+    if (rest >= 0 && rest <= interior) interior_weight[t] = std::exp(LogChoose(interior, rest) - max_log);
+  }
+
+  // prefix[j] and suffix[j] are the combined counts of components before j and from j on
+  int n = static_cast<int>(counts.size());
+  std::vector<std::vector<double>> prefix(n + 1), suffix(n + 1);
+  prefix[0] = {1};
+  suffix[n] = {1};
+  for (int j = 0; j < n; j++) prefix[j + 1] = Convolve(prefix[j], counts[j].solutions);
+  for (int j = n - 1; j >= 0; j--) suffix[j] = Convolve(counts[j].solutions, suffix[j + 1]);
+
+  double total = 0, interior_mines = 0;
+  for (size_t t = 0; t < prefix[n].size(); t++) {
+    total += prefix[n][t] * interior_weight[t];
+    if (interior > 0) {
+      interior_mines += prefix[n][t] * interior_weight[t] * (model.remaining_mines - static_cast<int>(t)) / interior;
+    }
+  }
+  if (total <= 0) {
+    result.global = false;
+    return result;
+  }
+  for (int id : model.interior) {
+    result.mine_probability[id] = interior_mines / total;
+  }
+
+  for (int j = 0; j < n; j++) {
+    std::vector<double> others = Convolve(prefix[j], suffix[j + 1]);
+    const ComponentCount &count = counts[j];
+    std::vector<double> weight(count.solutions.size(), 0);
+    for (size_t k = 0; k < count.solutions.size(); k++) {
+      for (size_t s = 0; s < others.size(); s++) {
+        weight[k] += others[s] * interior_weight[k + s];
+      }
+    }
+    for (size_t i = 0; i < count.cells.size(); i++) {
+      double mine_weight = 0, safe_weight = 0;
+      for (size_t k = 0; k < count.solutions.size(); k++) {
+        mine_weight += count.cell_mines[k][i] * weight[k];
+        safe_weight += (count.solutions[k] - count.cell_mines[k][i]) * weight[k];
+      }
+      int id = model.frontier[count.cells[i]];
+      result.mine_probability[id] = mine_weight / total;
+      if (mine_weight == 0) result.safe_cells.push_back(id);
+      if (safe_weight == 0) result.mine_cells.push_back(id);
+    }
+  }
+  if (interior > 0 && interior_mines == 0) {
+    result.safe_cells.insert(result.safe_cells.end(), model.interior.begin(), model.interior.end());
+  }
+  return result;
+}
+
+/*
+ * Monte Carlo sampling.
+ * Each thread runs its own Markov chain over the frontier layouts that satisfy every constraint, with its own
+ * std::mt19937_64 stream. A layout with k frontier mines has weight C(interior, remaining_mines - k), the number of ways
+ * to place the other mines in the interior. The chain starts from a layout found by randomized backtracking. Every step
+ * picks a block of frontier grids, lists every assignment of the block that keeps the layout consistent, and draws one of
+ * them by weight. A block grows breadth-first through shared constraints from a random grid, to a random size of up to
+ * kSamplerMaxBlock; every other block grows from two random grids, so it can move mines between distant parts of the
+ * frontier. Such a Gibbs update leaves the weights invariant, and the state is recorded every kSamplerThin steps whether
+ * or not it changed. A block whose listing needs more than kSamplerBlockNodes nodes is left as it is. The listing only
+ * depends on the grids outside the block, so this choice does not depend on the block itself and keeps the weights
+ * invariant. The interior is not sampled grid by grid: given the number of interior mines, its contribution is added in
+ * closed form. A sampling run stops after kSamplerSteps updates or once kSamplerBudget has passed, whichever comes
+ * first, and the guess is made from the states recorded until then.
+ */
+
+const long long kSamplerSteps = 20000;        // Most block updates of one sampling run, shared by all threads
+const std::chrono::milliseconds kSamplerBudget(60);  // Most time of one sampling run
+const int kSamplerMaxThreads = 4;
+const long long kSamplerBurnIn = 1000;        // Block updates of a chain before its first recorded state
+const int kSamplerThin = 4;                   // Block updates between two recorded states
+const int kSamplerClockSteps = 64;            // Block updates between two looks at the clock
+const int kSamplerMinBlock = 6;               // Size range of the blocks resampled by one update
+const int kSamplerMaxBlock = 24;
+const long long kSamplerStartNodes = 100000;  // Search nodes allowed to find the first consistent layout
+const int kSamplerBlockNodes = 1024;          // Search nodes allowed to list the assignments of one block
+
+// Per-grid statistics of the recorded states, indexed by unknown slot (frontier grids first, then interior grids)
+struct SampleStats {
+  std::vector<double> safe;  // Weight of states in which the grid is safe
+  std::vector<double> zero;  // Weight of states in which the grid is safe and shows 0, so visiting it opens an area
+  double samples = 0;
+};
+
+// Neighbors of every unknown slot, used to estimate how much a visit reveals
+struct SampleNeighbors {
+  std::vector<std::vector<int>> frontier;  // Frontier indices around each slot
+  std::vector<int> interior;               // Number of interior grids around each slot
+};
+
+SampleNeighbors BuildSampleNeighbors(const FrontierModel &model) {
+  SampleNeighbors neighbors;
+  size_t slots = model.frontier.size() + model.interior.size();
+  neighbors.frontier.resize(slots);
+  neighbors.interior.assign(slots, 0);
+  for (size_t slot = 0; slot < slots; slot++) {
+    int id = slot < model.frontier.size() ? model.frontier[slot] : model.interior[slot - model.frontier.size()];
+    int r = id / columns, c = id % columns;
+    for (int dr = -1; dr <= 1; dr++) {
+      for (int dc = -1; dc <= 1; dc++) {
+        if (dr == 0 && dc == 0) continue;
+        int nr = r + dr, nc = c + dc;
+        if (!IsValidClient(nr, nc) || IsVisitedClient(nr, nc) || IsMarkedClient(nr, nc)) continue;
+        int index = model.frontier_index[nr * columns + nc];
+        if (index >= 0) {
+          neighbors.frontier[slot].push_back(index);
+        } else {
+          neighbors.interior[slot]++;
+        }
       }
     }
   }
+  return neighbors;
+}
+
+// Probability that `count` given interior grids are all safe when `mines` mines are spread over `interior` grids
+double InteriorAllSafe(int interior, int mines, int count) {
+  double probability = 1;
+  for (int t = 0; t < count; t++) {
+    if (interior - mines - t <= 0) return 0;
+    probability *= static_cast<double>(interior - mines - t) / (interior - t);
+  }
+  return probability;
+}
+
+// Add the current state of a chain to its statistics
+void RecordSample(const FrontierModel &model, const SampleNeighbors &neighbors, const std::vector<char> &mine,
+                  SampleStats &stats) {
+  int frontier = static_cast<int>(model.frontier.size());
+  int interior = static_cast<int>(model.interior.size());
+  int rest = model.remaining_mines;
+  for (int i = 0; i < frontier; i++) rest -= mine[i];
+  double all_safe[10];  // all_safe[k]: probability that k given interior grids are all safe
+  for (int k = 0; k < 10; k++) all_safe[k] = InteriorAllSafe(interior, rest, k);
+  for (size_t slot = 0; slot < stats.safe.size(); slot++) {
+    bool frontier_slot = slot < static_cast<size_t>(frontier);
+    if (frontier_slot ? mine[slot] : all_safe[1] == 0) continue;
+    stats.safe[slot] += frontier_slot ? 1 : all_safe[1];
+    bool open = true;
+    for (int index : neighbors.frontier[slot]) {
+      if (mine[index]) {
+        open = false;
+        break;
+      }
+    }
+    if (!open) continue;
+    int count = neighbors.interior[slot];
+    stats.zero[slot] += frontier_slot ? all_safe[count] : all_safe[count + 1];
+  }
+  stats.samples += 1;
+}
+
+// State of one sampling chain
+struct SamplerChain {
+  const FrontierModel *model;
+  std::mt19937_64 rng;
+  std::vector<char> mine;       // Current layout of the frontier
+  std::vector<int> mines;       // Mines around each constraint, counting only assigned grids
+  std::vector<int> unassigned;  // Unassigned grids around each constraint
+  int mine_total = 0;           // Mines of the assigned frontier grids
+  long long nodes = 0;          // Search nodes of FindStartLayout()
+  int block_nodes = 0;          // Search nodes of the current block listing
+  std::vector<int> block;               // Grids of the current update, in breadth-first order
+  std::vector<char> in_block;
+  std::vector<double> interior_log;     // interior_log[rest]: LogChoose(interior, rest)
+  std::vector<uint32_t> block_layouts;  // Consistent assignments of the block, bit i for block[i]
+  std::vector<int> block_mines;         // Mines of each of them
+};
+
+// Assign `value` to a frontier grid, or take it back with sign -1, and check that its constraints can still be met
+bool AssignSamplerCell(SamplerChain &chain, int cell, int value, int sign) {
+  const FrontierModel &model = *chain.model;
+  bool feasible = true;
+  chain.mine_total += sign * value;
+  for (int constraint : model.cell_constraints[cell]) {
+    chain.unassigned[constraint] -= sign;
+    chain.mines[constraint] += sign * value;
+    int need = model.constraint_need[constraint];
+    if (chain.mines[constraint] > need || chain.mines[constraint] + chain.unassigned[constraint] < need) {
+      feasible = false;
+    }
+  }
+  return feasible;
+}
+
+// Find one consistent layout by backtracking over `order` with random value order
+bool FindStartLayout(SamplerChain &chain, const std::vector<int> &order, int position) {
+  const FrontierModel &model = *chain.model;
+  if (++chain.nodes > kSamplerStartNodes) return false;
+  if (position == static_cast<int>(order.size())) {
+    int rest = model.remaining_mines - chain.mine_total;
+    return rest >= 0 && rest <= static_cast<int>(model.interior.size());
+  }
+  int cell = order[position];
+  int first = static_cast<int>(chain.rng() & 1);
+  for (int value : {first, 1 - first}) {
+    bool feasible = AssignSamplerCell(chain, cell, value, 1) && chain.mine_total <= model.remaining_mines;
+    if (feasible && FindStartLayout(chain, order, position + 1)) {
+      chain.mine[cell] = static_cast<char>(value);
+      return true;
+    }
+    AssignSamplerCell(chain, cell, value, -1);
+  }
   return false;
 }
 
+// List every consistent assignment of the block from `position` on
+void ListBlockLayouts(SamplerChain &chain, int position, uint32_t layout, int block_mines) {
+  if (++chain.block_nodes > kSamplerBlockNodes) return;
+  if (position == static_cast<int>(chain.block.size())) {
+    chain.block_layouts.push_back(layout);
+    chain.block_mines.push_back(block_mines);
+    return;
+  }
+  int cell = chain.block[position];
+  for (int value = 0; value <= 1; value++) {
+    if (AssignSamplerCell(chain, cell, value, 1)) {
+      ListBlockLayouts(chain, position + 1, layout | (static_cast<uint32_t>(value) << position), block_mines + value);
+    }
+    AssignSamplerCell(chain, cell, value, -1);
+  }
+}
+
+// Grow the block breadth-first from a random frontier grid until it has `size` grids or its component is exhausted
+void GrowSamplerBlock(SamplerChain &chain, size_t size) {
+  const FrontierModel &model = *chain.model;
+  size_t head = chain.block.size();
+  int start = static_cast<int>(chain.rng() % model.frontier.size());
+  if (chain.in_block[start]) return;
+  chain.in_block[start] = 1;
+  chain.block.push_back(start);
+  for (; head < chain.block.size() && chain.block.size() < size; head++) {
+    for (int constraint : model.cell_constraints[chain.block[head]]) {
+      for (int next : model.constraint_cells[constraint]) {
+        if (chain.in_block[next] || chain.block.size() >= size) continue;
+        chain.in_block[next] = 1;
+        chain.block.push_back(next);
+      }
+    }
+  }
+}
+
+// One Gibbs update: resample a random block given the rest of the layout
+void UpdateSamplerBlock(SamplerChain &chain) {
+  const FrontierModel &model = *chain.model;
+  int interior = static_cast<int>(model.interior.size());
+  size_t size = kSamplerMinBlock + chain.rng() % (kSamplerMaxBlock - kSamplerMinBlock + 1);
+  chain.block.clear();
+  if (chain.rng() & 1) {
+    GrowSamplerBlock(chain, size / 2);
+  }
+  GrowSamplerBlock(chain, size);
+  for (int cell : chain.block) {
+    chain.in_block[cell] = 0;
+    AssignSamplerCell(chain, cell, chain.mine[cell], -1);
+  }
+
+  chain.block_layouts.clear();
+  chain.block_mines.clear();
+  chain.block_nodes = 0;
+  ListBlockLayouts(chain, 0, 0, 0);
+  if (chain.block_nodes > kSamplerBlockNodes) {
+    for (int cell : chain.block) AssignSamplerCell(chain, cell, chain.mine[cell], 1);
+    return;
+  }
+  // weight[b]: interior placements left when the block holds b mines, relative to the largest
+  std::vector<double> weight(chain.block.size() + 1, 0);
+  double max_log = -1e300;
+  for (size_t b = 0; b < weight.size(); b++) {
+    int rest = model.remaining_mines - chain.mine_total - static_cast<int>(b);
+    if (rest >= 0 && rest <= interior) max_log = std::max(max_log, chain.interior_log[rest]);
+  }
+  for (size_t b = 0; b < weight.size(); b++) {
+    int rest = model.remaining_mines - chain.mine_total - static_cast<int>(b);
+    if (rest >= 0 && rest <= interior) weight[b] = std::exp(chain.interior_log[rest] - max_log);
+  }
+  double total = 0;
+  for (int block_mines : chain.block_mines) total += weight[block_mines];
+  double pick = std::uniform_real_distribution<double>(0.0, total)(chain.rng);
+  size_t chosen = 0;
+  while (chosen + 1 < chain.block_layouts.size() && (pick -= weight[chain.block_mines[chosen]]) >= 0) chosen++;
+  while (weight[chain.block_mines[chosen]] == 0) chosen--;  // Rounding at the end of the list
+
+  for (size_t i = 0; i < chain.block.size(); i++) {
+    chain.mine[chain.block[i]] = static_cast<char>(chain.block_layouts[chosen] >> i & 1);
+    AssignSamplerCell(chain, chain.block[i], chain.mine[chain.block[i]], 1);
+  }
+}
+
+// Run one chain for up to `steps` block updates, stopping early at `deadline`, and add its recorded states to stats
+void RunSamplerChain(const FrontierModel &model, const SampleNeighbors &neighbors, uint64_t seed, long long steps,
+                     std::chrono::steady_clock::time_point deadline, SampleStats &stats) {
+  size_t slots = model.frontier.size() + model.interior.size();
+  stats.safe.assign(slots, 0);
+  stats.zero.assign(slots, 0);
+  stats.samples = 0;
+  if (model.frontier.empty()) return;
+
+  SamplerChain chain;
+  chain.model = &model;
+  chain.rng.seed(seed);
+  chain.mine.assign(model.frontier.size(), 0);
+  chain.mines.assign(model.constraint_cells.size(), 0);
+  chain.unassigned.assign(model.constraint_cells.size(), 0);
+  for (size_t constraint = 0; constraint < model.constraint_cells.size(); constraint++) {
+    chain.unassigned[constraint] = static_cast<int>(model.constraint_cells[constraint].size());
+  }
+  chain.in_block.assign(model.frontier.size(), 0);
+  for (int rest = 0; rest <= static_cast<int>(model.interior.size()); rest++) {
+    chain.interior_log.push_back(LogChoose(static_cast<int>(model.interior.size()), rest));
+  }
+  std::vector<int> order;
+  for (const std::vector<int> &cells : SplitComponents(model)) order.insert(order.end(), cells.begin(), cells.end());
+  if (!FindStartLayout(chain, order, 0)) return;
+
+  for (long long step = 0; step < steps; step++) {
+    if (step % kSamplerClockSteps == 0 && std::chrono::steady_clock::now() >= deadline) break;
+    UpdateSamplerBlock(chain);
+    if (step >= kSamplerBurnIn && step % kSamplerThin == 0) RecordSample(model, neighbors, chain.mine, stats);
+  }
+}
+
+/**
+ * Draw layouts consistent with the visible map on several threads and merge their statistics. Every thread gets its own
+ * seed from client_rng. A run that finishes its kSamplerSteps updates within kSamplerBudget is reproducible for a given
+ * client_rng state; a slower run keeps the states recorded before the deadline.
+ */
+SampleStats SampleLayouts(const FrontierModel &model) {
+  SampleNeighbors neighbors = BuildSampleNeighbors(model);
+  int threads = ClientThreadCount(kSamplerMaxThreads);
+  std::vector<SampleStats> partial(threads);
+  std::vector<uint64_t> seeds(threads);
+  for (int t = 0; t < threads; t++) seeds[t] = client_rng();
+  long long steps = kSamplerSteps / threads;
+  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + kSamplerBudget;
+  RunOnWorkers([&](int t) { RunSamplerChain(model, neighbors, seeds[t], steps, deadline, partial[t]); }, threads);
+
+  SampleStats stats = partial[0];
+  for (int t = 1; t < threads; t++) {
+    for (size_t slot = 0; slot < stats.safe.size(); slot++) {
+      stats.safe[slot] += partial[t].safe[slot];
+      stats.zero[slot] += partial[t].zero[slot];
+    }
+    stats.samples += partial[t].samples;
+  }
+  return stats;
+}
+
+const double kRevealWeight = 0.15;  // Value of opening an area, relative to the safe probability of a guess
+
+/**
+ * Choose the grid to visit when no grid is known to be safe. A guess is scored by its safe probability plus
+ * kRevealWeight times the probability that it shows 0 and so opens an area; the number of grids such an area reveals is
+ * not estimated. When the exact reasoning covers the whole map, the safe probability is exact and the chance of a 0 is
+ * estimated from the mine probabilities of the neighbors, taken as independent. Otherwise both come from the samples.
+ */
+bool FindBestGuess(const FrontierModel &model, const ExactResult &exact, int &r, int &c) {
+  SampleStats stats;
+  if (!exact.global) stats = SampleLayouts(model);
+  int frontier = static_cast<int>(model.frontier.size());
+  int interior = static_cast<int>(model.interior.size());
+  double best = -1;
+  for (int slot = 0; slot < frontier + interior; slot++) {
+    int id = slot < frontier ? model.frontier[slot] : model.interior[slot - frontier];
+    double safe, zero = 0;
+    if (exact.global) {
+      safe = 1.0 - exact.mine_probability[id];
+      zero = safe;
+      for (int dr = -1; dr <= 1; dr++) {
+        for (int dc = -1; dc <= 1; dc++) {
+          int nr = id / columns + dr, nc = id % columns + dc;
+          if ((dr == 0 && dc == 0) || !IsValidClient(nr, nc) || IsVisitedClient(nr, nc) || IsMarkedClient(nr, nc)) {
+            continue;
+          }
+          zero *= 1.0 - exact.mine_probability[nr * columns + nc];
+        }
+      }
+    } else if (stats.samples > 0) {
+      safe = stats.safe[slot] / stats.samples;
+      zero = stats.zero[slot] / stats.samples;
+    } else if (slot >= frontier && interior > 0) {
+      safe = 1.0 - static_cast<double>(model.remaining_mines) / (frontier + interior);
+    } else {
+      safe = 0.5;
+    }
+    double score = safe + kRevealWeight * zero;
+    if (score > best) {
+      best = score;
+      r = id / columns;
+      c = id % columns;
+    }
+  }
+  return best >= 0;
+}
+
+/*
+ * Endgame solver.
+ * Once few unknown grids remain, every layout of the remaining mines that agrees with all numbers and with the exact
+ * remaining mine count is listed as a bitmask over the unknown grids (frontier grids first, then interior grids). A
+ * guess splits the layouts by the number it would show. The search plays risk-free visits whenever some grid is safe in
+ * all layouts left, and otherwise tries every guess up to kEndgameDepth guesses deep, to find the guess with the highest
+ * chance of winning the game.
+ */
+
+const int kEndgameMaxUnknown = 24;           // The endgame starts when at most this many grids are unknown
+const size_t kEndgameMaxLayouts = 4096;      // More consistent layouts than this leave the guess to the sampler
+const int kEndgameDepth = 4;                 // Guesses searched ahead; deeper positions are valued by their safest guess
+const long long kEndgameNodeLimit = 200000;  // Search nodes of one endgame decision
+
+static_assert(kEndgameMaxUnknown <= 32, "The numbers shown during the endgame search are packed in two words");
+
+// Number of set bits of a mask
+int CountMaskBits(uint64_t mask) {
+#if defined(__GNUC__)
+  return __builtin_popcountll(mask);
+#else
+  int count = 0;
+  for (; mask != 0; mask &= mask - 1) count++;
+  return count;
+#endif
+}
+
+// Index of the lowest set bit of a non-zero mask
+int LowestMaskBit(uint64_t mask) {
+#if defined(__GNUC__)
+  return __builtin_ctzll(mask);
+#else
+  int bit = 0;
+  for (; !(mask & 1); mask >>= 1) bit++;
+  return bit;
+#endif
+}
+
+/**
+ * A position of the endgame search. The layouts left are exactly those that agree with the numbers shown by the visited
+ * grids, so the visited grids, their numbers and the guesses left identify the position without any hashing.
+ */
+struct EndgamePosition {
+  uint64_t revealed = 0;       // Grids visited during the search
+  uint64_t shown[2] = {0, 0};  // Number shown by each visited grid, four bits per grid
+  int depth = 0;               // Guesses that may still be searched
+
+  bool operator==(const EndgamePosition &other) const {
+    return revealed == other.revealed && shown[0] == other.shown[0] && shown[1] == other.shown[1] &&
+           depth == other.depth;
+  }
+};
+
+struct EndgamePositionHash {
+  size_t operator()(const EndgamePosition &position) const {
+    uint64_t hash = position.revealed * 0x9e3779b97f4a7c15ULL + static_cast<uint64_t>(position.depth);
+    hash = (hash ^ position.shown[0]) * 0xff51afd7ed558ccdULL;
+    hash = (hash ^ position.shown[1]) * 0xc4ceb9fe1a85ec53ULL;
+    return static_cast<size_t>(hash ^ (hash >> 32));
+  }
+};
+
+struct EndgameSearch {
+  const FrontierModel *model;
+  int cells;                            // Unknown grids, at most kEndgameMaxUnknown
+  uint64_t all;                         // Mask of all unknown grids
+  std::vector<uint64_t> neighbors;      // Mask of the unknown neighbors of each unknown grid
+  std::vector<uint64_t> layouts;        // Every consistent layout, as a mask of its mines
+  std::vector<int> mines, unassigned;   // Per constraint, while the layouts are listed
+  std::unordered_map<EndgamePosition, double, EndgamePositionHash> memo;
+  long long nodes = 0;
+  bool exhausted = false;               // Whether a limit was hit, so the result cannot be trusted
+};
+
+// List every layout of the unknown grids from `slot` on
+void CollectLayouts(EndgameSearch &search, int slot, int mine_total, uint64_t layout) {
+  const FrontierModel &model = *search.model;
+  if (search.exhausted) return;
+  int rest = model.remaining_mines - mine_total;
+  if (rest < 0 || rest > search.cells - slot) return;
+  if (slot == search.cells) {
+    search.layouts.push_back(layout);
+    if (search.layouts.size() > kEndgameMaxLayouts) search.exhausted = true;
+    return;
+  }
+  bool frontier = slot < static_cast<int>(model.frontier.size());
+  for (int value = 0; value <= 1; value++) {
+    bool feasible = true;
+    if (frontier) {
+      for (int constraint : model.cell_constraints[slot]) {
+        search.unassigned[constraint]--;
+        search.mines[constraint] += value;
+        int need = model.constraint_need[constraint];
+        if (search.mines[constraint] > need || search.mines[constraint] + search.unassigned[constraint] < need) {
+          feasible = false;
+        }
+      }
+    }
+    if (feasible) {
+      CollectLayouts(search, slot + 1, mine_total + value, value ? layout | (1ULL << slot) : layout);
+    }
+    if (frontier) {
+      for (int constraint : model.cell_constraints[slot]) {
+        search.unassigned[constraint]++;
+        search.mines[constraint] -= value;
+      }
+    }
+  }
+}
+
+double EndgameValue(EndgameSearch &search, const std::vector<uint64_t> &layouts, const EndgamePosition &position,
+                    int *best_slot);
+
+// Chance to win after visiting `slot`: the layouts in which it is safe are split by the number it shows
+double EndgameVisitValue(EndgameSearch &search, const std::vector<uint64_t> &layouts, const EndgamePosition &position,
+                         int slot) {
+  std::vector<uint64_t> groups[9];
+  for (uint64_t layout : layouts) {
+    if (!(layout >> slot & 1)) groups[CountMaskBits(layout & search.neighbors[slot])].push_back(layout);
+  }
+  double value = 0;
+  for (int number = 0; number <= 8; number++) {
+    if (groups[number].empty()) continue;
+    EndgamePosition next = position;
+    next.revealed |= 1ULL << slot;
+    next.shown[slot / 16] |= static_cast<uint64_t>(number) << (slot % 16 * 4);
+    value += groups[number].size() * EndgameValue(search, groups[number], next, nullptr);
+  }
+  return value / layouts.size();
+}
+
+/**
+ * Chance to win from `position`, whose equally likely layouts are `layouts`. If best_slot is given, it receives the grid
+ * to visit.
+ */
+double EndgameValue(EndgameSearch &search, const std::vector<uint64_t> &layouts, const EndgamePosition &position,
+                    int *best_slot) {
+  if (layouts.size() == 1 && best_slot == nullptr) return 1;
+  if (++search.nodes > kEndgameNodeLimit) {
+    search.exhausted = true;
+    return 0;
+  }
+  if (best_slot == nullptr) {
+    auto it = search.memo.find(position);
+    if (it != search.memo.end()) return it->second;
+  }
+  uint64_t any_mine = 0, always_mine = search.all;
+  for (uint64_t layout : layouts) {
+    any_mine |= layout;
+    always_mine &= layout;
+  }
+
+  double best = 0;
+  uint64_t free_grids = search.all & ~any_mine & ~position.revealed;
+  if (free_grids != 0) {
+    // A grid that is safe in every layout costs nothing, so it is visited before any guess
+    int slot = LowestMaskBit(free_grids);
+    best = EndgameVisitValue(search, layouts, position, slot);
+    if (best_slot != nullptr) *best_slot = slot;
+  } else {
+    // Try the guesses from the safest one on. A guess cannot win more often than it is safe, which bounds the search.
+    std::vector<std::pair<int, int>> guesses;  // (layouts in which the grid is safe, grid)
+    for (int slot = 0; slot < search.cells; slot++) {
+      if ((position.revealed | always_mine) >> slot & 1) continue;
+      int safe = 0;
+      for (uint64_t layout : layouts) safe += !(layout >> slot & 1);
+      guesses.emplace_back(safe, slot);
+    }
+    std::sort(guesses.rbegin(), guesses.rend());
+    EndgamePosition next = position;
+    next.depth--;
+    for (const std::pair<int, int> &guess : guesses) {
+      double bound = static_cast<double>(guess.first) / layouts.size();
+      if (bound <= best) break;
+      double value = position.depth == 0 ? bound : EndgameVisitValue(search, layouts, next, guess.second);
+      if (value > best) {
+        best = value;
+        if (best_slot != nullptr) *best_slot = guess.second;
+      }
+    }
+  }
+  search.memo[position] = best;
+  return best;
+}
+
+/**
+ * Choose the guess with the highest chance of winning when few grids are unknown. Returns false if the position is too
+ * big for the search, so the guess is left to FindBestGuess().
+ */
+bool FindEndgameMove(const FrontierModel &model, int &r, int &c) {
+  EndgameSearch search;
+  search.model = &model;
+  search.cells = static_cast<int>(model.frontier.size() + model.interior.size());
+  if (search.cells == 0 || search.cells > kEndgameMaxUnknown) return false;
+  search.all = (1ULL << search.cells) - 1;
+  std::vector<int> slot_of(rows * columns, -1);
+  for (int slot = 0; slot < search.cells; slot++) {
+    int frontier = static_cast<int>(model.frontier.size());
+    slot_of[slot < frontier ? model.frontier[slot] : model.interior[slot - frontier]] = slot;
+  }
+  search.neighbors.assign(search.cells, 0);
+  for (int id = 0; id < rows * columns; id++) {
+    if (slot_of[id] < 0) continue;
+    int r0 = id / columns, c0 = id % columns;
+    for (int dr = -1; dr <= 1; dr++) {
+      for (int dc = -1; dc <= 1; dc++) {
+        int nr = r0 + dr, nc = c0 + dc;
+        if ((dr != 0 || dc != 0) && IsValidClient(nr, nc) && slot_of[nr * columns + nc] >= 0) {
+          search.neighbors[slot_of[id]] |= 1ULL << slot_of[nr * columns + nc];
+        }
+      }
+    }
+  }
+  search.mines.assign(model.constraint_cells.size(), 0);
+  search.unassigned.assign(model.constraint_cells.size(), 0);
+  for (size_t constraint = 0; constraint < model.constraint_cells.size(); constraint++) {
+    search.unassigned[constraint] = static_cast<int>(model.constraint_cells[constraint].size());
+  }
+  CollectLayouts(search, 0, 0, 0);
+  if (search.exhausted || search.layouts.empty()) return false;
+
+  int best_slot = -1;
+  EndgamePosition start;
+  start.depth = kEndgameDepth;
+  EndgameValue(search, search.layouts, start, &best_slot);
+  if (search.exhausted || best_slot < 0) return false;
+  int frontier = static_cast<int>(model.frontier.size());
+  int id = best_slot < frontier ? model.frontier[best_slot] : model.interior[best_slot - frontier];
+  r = id / columns;
+  c = id % columns;
+  return true;
+}
+
+/*
+ * Solver state kept between two calls of Decide().
+ * Decide() only resumes the solver, which hands out one move at a time. Moves that are already proven wait in
+ * client_plan and are executed later without any new reasoning. ReadMap() puts every changed grid and its neighbors in
+ * client_dirty, so the simple rules only look at numbers whose surroundings changed since they were last checked. The
+ * grids within two rows and columns of a change go to client_pattern_dirty in the same way, which covers every pair
+ * whose pattern includes the changed grid, so the pattern table is only consulted for those pairs. The frontier model
+ * itself is rebuilt by one scan of the map, but the counts of its components are kept in client_component_counts.
+ */
+
+// A move of the client, with the types of Execute()
+struct ClientMove {
+  int r, c, type;
+};
+
+std::deque<ClientMove> client_plan;         // Proven moves not executed yet
+std::vector<int> client_dirty;              // Ids of grids whose surroundings changed
+std::vector<char> client_is_dirty;          // Whether each id is in client_dirty
+std::vector<int> client_pattern_dirty;      // Ids of grids whose pairs may match a different pattern
+std::vector<char> client_is_pattern_dirty;  // Whether each id is in client_pattern_dirty
+
+void MarkDirty(int r, int c) {
+  for (int dr = -2; dr <= 2; dr++) {
+    for (int dc = -2; dc <= 2; dc++) {
+      int nr = r + dr, nc = c + dc;
+      if (!IsValidClient(nr, nc)) continue;
+      int id = nr * columns + nc;
+      if (dr >= -1 && dr <= 1 && dc >= -1 && dc <= 1 && !client_is_dirty[id]) {
+        client_is_dirty[id] = 1;
+        client_dirty.push_back(id);
+      }
+      if (!client_is_pattern_dirty[id]) {
+        client_is_pattern_dirty[id] = 1;
+        client_pattern_dirty.push_back(id);
+      }
+    }
+  }
+}
+
+// A planned move is still useful if its grid is unknown, or for AutoExplore, if its number still has unknown neighbors
+bool IsPlannedMoveUseful(const ClientMove &move) {
+  if (move.type == 2) {
+    return CountUnvisitedNeighbors(move.r, move.c) > 0;
+  }
+  return !IsVisitedClient(move.r, move.c) && !IsMarkedClient(move.r, move.c);
+}
+
+/**
+ * Apply the simple rules to every dirty number. If all mines around a number are marked, one AutoExplore visits all its
+ * other neighbors; if its unknown neighbors are exactly the missing mines, they are all marked.
+ */
+void PlanSimpleMoves() {
+  while (!client_dirty.empty()) {
+    int id = client_dirty.back();
+    client_dirty.pop_back();
+    client_is_dirty[id] = 0;
+    int r = id / columns, c = id % columns;
+    if (!IsVisitedClient(r, c) || ClientCell(r, c) < '0' || ClientCell(r, c) > '8') continue;
+    int unknown = CountUnvisitedNeighbors(r, c);
+    if (unknown == 0) continue;
+    int missing = MissingMines(r, c);
+    if (missing == 0) {
+      client_plan.push_back({r, c, 2});
+    } else if (missing == unknown) {
+      for (int dr = -1; dr <= 1; dr++) {
+        for (int dc = -1; dc <= 1; dc++) {
+          int nr = r + dr, nc = c + dc;
+          if ((dr != 0 || dc != 0) && IsValidClient(nr, nc) && !IsVisitedClient(nr, nc) && !IsMarkedClient(nr, nc)) {
+            client_plan.push_back({nr, nc, 1});
+          }
+        }
+      }
+    }
+  }
+}
+
+/**
+ * Look up in kPatternTable the pairs of every pattern-dirty number, with its right and lower neighbors and with its left
+ * and upper ones. A number leaves client_pattern_dirty once none of its pairs forces a grid.
+ */
+bool FindPatternMove(int &r, int &c, int &type) {
+  while (!client_pattern_dirty.empty()) {
+    int id = client_pattern_dirty.back();
+    int i = id / columns, j = id % columns;
+    if (FindPairMove(i, j, 0, r, c, type) || FindPairMove(i, j, 1, r, c, type) ||
+        FindPairMove(i, j - 1, 0, r, c, type) || FindPairMove(i - 1, j, 1, r, c, type)) {
+      return true;
+    }
+    client_pattern_dirty.pop_back();
+    client_is_pattern_dirty[id] = 0;
+  }
+  return false;
+}
+
+bool PopPlannedMove(ClientMove &move) {
+  while (!client_plan.empty()) {
+    move = client_plan.front();
+    client_plan.pop_front();
+    if (IsPlannedMoveUseful(move)) return true;
+  }
+  return false;
+}
+
+/**
+ * Resume the solver with the latest observation and return the next move. Reasoning escalates from the plan, to the
+ * simple rules on dirty numbers, to the pattern table, to the exact reasoning over the whole frontier. Only when none of
+ * them proves anything does the solver guess.
+ */
+ClientMove ResumeSolver() {
+  ClientMove move{0, 0, 0};
+  if (PopPlannedMove(move)) return move;
+  PlanSimpleMoves();
+  if (PopPlannedMove(move)) return move;
+  if (FindPatternMove(move.r, move.c, move.type)) return move;
+
+  FrontierModel model = BuildFrontier();
+  ExactResult exact = ReasonExactly(model);
+  for (int id : exact.safe_cells) client_plan.push_back({id / columns, id % columns, 0});
+  for (int id : exact.mine_cells) client_plan.push_back({id / columns, id % columns, 1});
+  if (PopPlannedMove(move)) return move;
+
+  move.type = 0;
+  if (client_unvisited_count <= kEndgameMaxUnknown && FindEndgameMove(model, move.r, move.c)) return move;
+  if (!FindBestGuess(model, exact, move.r, move.c)) {
+    FindRandomUnvisited(move.r, move.c);
+  }
+  return move;
+}
+
 /**
  * @brief The definition of function Execute(int, int, bool)
  *
@@ -138,29 +1467,16 @@ void Execute(int r, int c, int type);
  */
 void InitGame() {
   // Initialize all your global variables!
-  client_map = new char*[rows];
-  client_safe = new bool*[rows];
-  client_mine = new bool*[rows];
-  client_visited = new bool*[rows];
-  client_marked = new bool*[rows];
-
-  for (int i = 0; i < rows; i++) {
-    client_map[i] = new char[columns];
-    client_safe[i] = new bool[columns];
-    client_mine[i] = new bool[columns];
-    client_visited[i] = new bool[columns];
-    client_marked[i] = new bool[columns];
-
-    for (int j = 0; j < columns; j++) {
-      client_map[i][j] = '?';
-      client_safe[i][j] = false;
-      client_mine[i][j] = false;
-      client_visited[i][j] = false;
-      client_marked[i][j] = false;
-    }
-  }
-
+  client_grid.assign(rows * columns, '?');
   client_unvisited_count = rows * columns;
+  client_marked_count = 0;
+  client_rng.seed(20251105);
+  client_plan.clear();
+  client_dirty.clear();
+  client_is_dirty.assign(rows * columns, 0);
+  client_pattern_dirty.clear();
+  client_is_pattern_dirty.assign(rows * columns, 0);
+  client_component_counts.clear();
 
   int first_row, first_column;
   std::cin >> first_row >> first_column;
@@ -178,44 +1494,14 @@ void InitGame() {
  *     01?
  */
 void ReadMap() {
-  // Read the current map state from stdin
-  for (int i = 0; i < rows; i++) {
-    for (int j = 0; j < columns; j++) {
-      std::cin >> client_map[i][j];
-
-      // Update visited and marked states
-      if (client_map[i][j] != '?' && client_map[i][j] != '@' && client_map[i][j] != 'X') {
-        // It's a number (visited non-mine)
-        client_visited[i][j] = true;
-        client_marked[i][j] = false;
-        client_mine[i][j] = false;
-        client_safe[i][j] = true;
-      } else if (client_map[i][j] == '@') {
-        // Marked mine
-        client_marked[i][j] = true;
-        client_visited[i][j] = false;
-        client_mine[i][j] = true;
-        client_safe[i][j] = false;
-      } else if (client_map[i][j] == 'X') {
-        // Wrong mark or visited mine (game over)
-        client_marked[i][j] = false;
-        client_visited[i][j] = true;
-        client_mine[i][j] = false;
-        client_safe[i][j] = false;
-      } else {
-        // Unknown
-        client_visited[i][j] = false;
-        client_marked[i][j] = false;
-      }
-    }
-  }
-
-  // Update unvisited count
-  client_unvisited_count = 0;
+  // Read the current map state from stdin. Only the grids that changed are written.
   for (int i = 0; i < rows; i++) {
     for (int j = 0; j < columns; j++) {
-      if (!client_visited[i][j] && !client_marked[i][j]) {
-        client_unvisited_count++;
+      char cell;
+      std::cin >> cell;
+      if (cell != client_grid[i * columns + j]) {
+        WriteClientCell(i * columns + j, cell);
+        MarkDirty(i, j);
       }
     }
   }
@@ -228,75 +1514,9 @@ void ReadMap() {
  * mind and make your decision here! Caution: you can only execute once in this function.
  */
 void Decide() {
-  int r, c;
-  int type = 0; // Default to visit
-
-  // Strategy 1: Look for obvious safe moves
-  if (FindSafeMove(r, c)) {
-    // Found a safe move - either visit safe cell or mark mine
-    // Check if we should mark or visit
-    bool should_mark = false;
-
-    // If the cell is already known to be a mine, mark it
-    for (int i = 0; i < rows; i++) {
-      for (int j = 0; j < columns; j++) {
-        if (client_visited[i][j] && client_map[i][j] >= '1' && client_map[i][j] <= '8') {
-          int number = client_map[i][j] - '0';
-          int marked_count = CountMarkedNeighbors(i, j);
-          int unvisited_count = CountUnvisitedNeighbors(i, j);
-
-          // If number equals marked + unvisited, all unvisited are mines
-          if (number == marked_count + unvisited_count) {
-            for (int dr = -1; dr <= 1; dr++) {
-              for (int dc = -1; dc <= 1; dc++) {
-                if (dr == 0 && dc == 0) continue;
-                int nr = i + dr, nc = j + dc;
-                if (nr == r && nc == c) {
-                  should_mark = true;
-                  break;
-                }
-              }
-              if (should_mark) break;
-            }
-          }
-        }
-      }
-    }
-
-    if (should_mark) {
-      type = 1; // Mark mine
-    } else {
-      type = 0; // Visit safe cell
-    }
-  }
-  // Strategy 2: Make a random safe move
-  else if (FindRandomUnvisited(r, c)) {
-    type = 0; // Visit random unvisited cell
-  }
-  // Strategy 3: If no unvisited cells, try auto-explore
-  else {
-    // Look for visited cells that might benefit from auto-explore
-    for (int i = 0; i < rows; i++) {
-      for (int j = 0; j < columns; j++) {
-        if (client_visited[i][j] && client_map[i][j] >= '1' && client_map[i][j] <= '8') {
-          int number = client_map[i][j] - '0';
-          int marked_count = CountMarkedNeighbors(i, j);
-
-          // If number equals marked count, auto-explore might be useful
-          if (number == marked_count && CountUnvisitedNeighbors(i, j) > 0) {
-            r = i;
-            c = j;
-            type = 2; // Auto-explore
-            break;
-          }
-        }
-      }
-      if (type == 2) break;
-    }
-  }
-
-  // Execute the chosen move
-  Execute(r, c, type);
+  // The solver keeps its plan and its dirty grids between calls, so deciding only resumes it
+  ClientMove move = ResumeSolver();
+  Execute(move.r, move.c, move.type);
 }
 
 #endif
\ No newline at end of file
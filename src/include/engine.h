@@ -0,0 +1,223 @@
+/**
+ * This header file contains a self-contained version of the game server, used by the tools that run many games in one
+ * process. It follows exactly the rules of server.h, but keeps all the state of a game inside one Game object instead of
+ * global variables, so several games can live side by side and a finished game can be reused for the next one.
+ *
+ * The map is stored with a border of one grid on each side, so neighbors never need a bounds check, and zero areas are
+ * opened with an explicit stack instead of recursion.
+ */
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Game {
+ public:
+  /**
+   * Start a new game on the given map. lines[i][j] is 'X' for a mine and '.' otherwise, as in the input of InitMap().
+   * The storage of a previous game is reused.
+   */
+  void Load(int rows, int columns, const std::string *lines) {
+    rows_ = rows;
+    columns_ = columns;
+    stride_ = columns + 2;
+    int size = (rows + 2) * stride_;
+    mine_.assign(size, 0);
+    adjacent_.assign(size, 0);
+    flags_.assign(size, kBorder);
+    display_.assign(size, '?');
+    const int offsets[8] = {-stride_ - 1, -stride_, -stride_ + 1, -1, 1, stride_ - 1, stride_, stride_ + 1};
+    for (int k = 0; k < 8; k++) {
+      offsets_[k] = offsets[k];
+    }
+    total_mines_ = 0;
+    for (int i = 0; i < rows; i++) {
+      for (int j = 0; j < columns; j++) {
+        int id = Index(i, j);
+        flags_[id] = 0;
+        if (lines[i][j] == 'X') {
+          mine_[id] = 1;
+          total_mines_++;
+          for (int offset : offsets_) {
+            adjacent_[id + offset]++;
+          }
+        }
+      }
+    }
+    state_ = 0;
+    visited_count_ = 0;
+    marked_mine_count_ = 0;
+  }
+
+  // Same as VisitBlock(r, c) in server.h
+  void Visit(int r, int c) {
+    if (state_ != 0 || !IsValid(r, c)) {
+      return;
+    }
+    int id = Index(r, c);
+    if (flags_[id] & (kVisited | kMarked)) {
+      return;
+    }
+    if (mine_[id]) {
+      flags_[id] |= kVisited;
+      display_[id] = 'X';
+      state_ = -1;
+      return;
+    }
+    Open(id);
+    if (IsWon()) {
+      state_ = 1;
+    }
+  }
+
+  // Same as MarkMine(r, c) in server.h
+  void Mark(int r, int c) {
+    if (state_ != 0 || !IsValid(r, c)) {
+      return;
+    }
+    int id = Index(r, c);
+    if (flags_[id] & (kVisited | kMarked)) {
+      return;
+    }
+    flags_[id] |= kMarked;
+    if (!mine_[id]) {
+      display_[id] = 'X';
+      state_ = -1;
+      return;
+    }
+    display_[id] = '@';
+    marked_mine_count_++;
+    if (IsWon()) {
+      state_ = 1;
+    }
+  }
+
+  // Same as AutoExplore(r, c) in server.h
+  void AutoExplore(int r, int c) {
+    if (state_ != 0 || !IsValid(r, c)) {
+      return;
+    }
+    int id = Index(r, c);
+    if (!(flags_[id] & kVisited) || mine_[id]) {
+      return;
+    }
+    int marked_count = 0;
+    for (int offset : offsets_) {
+      if (flags_[id + offset] & kMarked) {
+        marked_count++;
+      }
+    }
+    if (marked_count == adjacent_[id]) {
+      for (int offset : offsets_) {
+        int next = id + offset;
+        if (!(flags_[next] & (kBorder | kVisited | kMarked))) {
+          Visit((next / stride_) - 1, (next % stride_) - 1);
+          if (state_ != 0) {
+            return;
+          }
+        }
+      }
+    }
+    if (IsWon()) {
+      state_ = 1;
+    }
+  }
+
+  // Apply an operation given as in basic.cpp: 0 for Visit, 1 for Mark and 2 for AutoExplore. Other types are ignored.
+  void Apply(int r, int c, int type) {
+    if (type == 0) {
+      Visit(r, c);
+    } else if (type == 1) {
+      Mark(r, c);
+    } else if (type == 2) {
+      AutoExplore(r, c);
+    }
+  }
+
+  // The grid (r, c) as PrintMap() shows it
+  char Shown(int r, int c) const {
+    int id = Index(r, c);
+    return (state_ == 1 && mine_[id]) ? '@' : display_[id];
+  }
+
+  // Append the map as PrintMap() prints it, each line preceded by prefix
+  void Render(std::string &out, const std::string &prefix = "") const {
+    for (int i = 0; i < rows_; i++) {
+      out += prefix;
+      for (int j = 0; j < columns_; j++) {
+        out += Shown(i, j);
+      }
+      out += '\n';
+    }
+  }
+
+  // Append the two lines ExitGame() prints, each preceded by prefix
+  void RenderResult(std::string &out, const std::string &prefix = "") const {
+    out += prefix;
+    out += state_ == 1 ? "YOU WIN!\n" : "GAME OVER!\n";
+    out += prefix;
+    out += std::to_string(visited_count_);
+    out += ' ';
+    out += std::to_string(state_ == 1 ? total_mines_ : marked_mine_count_);
+    out += '\n';
+  }
+
+  int rows() const { return rows_; }
+  int columns() const { return columns_; }
+  int total_mines() const { return total_mines_; }
+  int state() const { return state_; }
+  int visited_count() const { return visited_count_; }
+  int marked_mine_count() const { return marked_mine_count_; }
+  bool visited(int r, int c) const { return flags_[Index(r, c)] & kVisited; }
+  bool marked(int r, int c) const { return flags_[Index(r, c)] & kMarked; }
+
+ private:
+  static constexpr uint8_t kVisited = 1;
+  static constexpr uint8_t kMarked = 2;
+  static constexpr uint8_t kBorder = 4;
+
+  bool IsValid(int r, int c) const { return r >= 0 && r < rows_ && c >= 0 && c < columns_; }
+  int Index(int r, int c) const { return (r + 1) * stride_ + c + 1; }
+  bool IsWon() const { return visited_count_ == rows_ * columns_ - total_mines_; }
+
+  // Visit a safe grid and every grid reachable from it through grids with mine count 0
+  void Open(int start) {
+    stack_.clear();
+    stack_.push_back(start);
+    flags_[start] |= kVisited;
+    while (!stack_.empty()) {
+      int id = stack_.back();
+      stack_.pop_back();
+      display_[id] = static_cast<char>('0' + adjacent_[id]);
+      visited_count_++;
+      if (adjacent_[id] != 0) {
+        continue;
+      }
+      for (int offset : offsets_) {
+        int next = id + offset;
+        if (!(flags_[next] & (kBorder | kVisited | kMarked))) {
+          flags_[next] |= kVisited;
+          stack_.push_back(next);
+        }
+      }
+    }
+  }
+
+  int rows_ = 0;
+  int columns_ = 0;
+  int stride_ = 0;
+  int offsets_[8] = {};
+  int total_mines_ = 0;
+  int state_ = 0;  // 0 for continuing, 1 for winning, -1 for losing
+  int visited_count_ = 0;
+  int marked_mine_count_ = 0;
+  std::vector<uint8_t> mine_;      // Whether each grid is a mine
+  std::vector<uint8_t> adjacent_;  // Mine count of each grid
+  std::vector<uint8_t> flags_;     // kVisited, kMarked and kBorder bits of each grid
+  std::vector<char> display_;      // Current display state, as display_map in server.h
+  std::vector<int> stack_;         // Work list of Open()
+};
+
+#endif
@@ -0,0 +1,155 @@
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "engine.h"
+
+/**
+ * Multiplexed game server.
+ *
+ * It hosts many games in one process, so a load generator does not pay process startup for every game. Every input
+ * line is a command tagged with a game id (any token without spaces):
+ *   C <id> <n> <m> <row_0> ... <row_{n-1}>  create a game; the rows use the characters of the basic.cpp input
+ *   O <id> <row> <column> <type>            apply an operation, with the types of basic.cpp
+ *   X <id>                                  close a game before it ends
+ * Every output line starts with the id of its game. After a game is created and after every operation, its map is
+ * printed as PrintMap() does. When a game ends, the two lines of ExitGame() follow and the game is closed. With --quiet,
+ * only those result lines are printed.
+ *
+ * Closed games go back to a pool and their storage is reused by the next created game. Invalid commands are reported on
+ * stderr and skipped; a command never reads past the end of its line, so it cannot affect the next one.
+ *
+ * Usage: server_mux [--quiet]
+ */
+
+// Games in use and the pool of closed games ready for reuse
+std::vector<Game> games;
+std::vector<int> free_games;
+std::unordered_map<std::string, int> game_of_id;
+
+std::string output;
+const size_t kFlushSize = 1 << 16;
+
+void Flush() {
+  std::cout.write(output.data(), static_cast<std::streamsize>(output.size()));
+  std::cout.flush();
+  output.clear();
+}
+
+int AcquireGame() {
+  if (free_games.empty()) {
+    games.emplace_back();
+    return static_cast<int>(games.size()) - 1;
+  }
+  int index = free_games.back();
+  free_games.pop_back();
+  return index;
+}
+
+void ReleaseGame(const std::string &id) {
+  auto it = game_of_id.find(id);
+  free_games.push_back(it->second);
+  game_of_id.erase(it);
+}
+
+int main(int argc, char *argv[]) {
+  bool quiet = false;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--quiet") == 0) {
+      quiet = true;
+    } else {
+      std::cerr << "Usage: " << argv[0] << " [--quiet]" << std::endl;
+      return 1;
+    }
+  }
+
+  std::ios::sync_with_stdio(false);
+  std::cin.tie(nullptr);
+
+  std::string line, command, id;
+  std::vector<std::string> lines;
+  while (true) {
+    // Flush before blocking on input, so an interactive peer always sees the answers to the commands it sent
+    if (!output.empty() && std::cin.rdbuf()->in_avail() <= 0) {
+      Flush();
+    }
+    if (!std::getline(std::cin, line)) {
+      break;
+    }
+    std::istringstream iss(line);
+    if (!(iss >> command)) {
+      continue;
+    }
+    if (!(iss >> id)) {
+      std::cerr << "Missing game id in command " << command << std::endl;
+      continue;
+    }
+    std::string prefix = id + " ";
+    if (command == "C") {
+      int n, m;
+      if (!(iss >> n >> m) || n <= 0 || m <= 0) {
+        std::cerr << "Invalid size for game " << id << std::endl;
+        continue;
+      }
+      lines.resize(n);
+      bool valid = true;
+      for (int i = 0; i < n; ++i) {
+        if (!(iss >> lines[i]) || static_cast<int>(lines[i].size()) != m) {
+          valid = false;
+          break;
+        }
+      }
+      if (!valid) {
+        std::cerr << "Invalid map for game " << id << std::endl;
+        continue;
+      }
+      if (game_of_id.count(id) != 0) {
+        std::cerr << "Game " << id << " already exists" << std::endl;
+        continue;
+      }
+      int index = AcquireGame();
+      game_of_id[id] = index;
+      games[index].Load(n, m, lines.data());
+      if (!quiet) {
+        games[index].Render(output, prefix);
+      }
+    } else if (command == "O") {
+      int r, c, type;
+      if (!(iss >> r >> c >> type)) {
+        std::cerr << "Invalid operation for game " << id << std::endl;
+        continue;
+      }
+      auto it = game_of_id.find(id);
+      if (it == game_of_id.end()) {
+        std::cerr << "Unknown game " << id << std::endl;
+        continue;
+      }
+      Game &game = games[it->second];
+      game.Apply(r, c, type);
+      if (!quiet) {
+        game.Render(output, prefix);
+      }
+      if (game.state() != 0) {
+        game.RenderResult(output, prefix);
+        ReleaseGame(id);
+      }
+    } else if (command == "X") {
+      if (game_of_id.count(id) == 0) {
+        std::cerr << "Unknown game " << id << std::endl;
+        continue;
+      }
+      ReleaseGame(id);
+    } else {
+      std::cerr << "Unknown command " << command << std::endl;
+      continue;
+    }
+    if (output.size() >= kFlushSize) {
+      Flush();
+    }
+  }
+  Flush();
+  return 0;
+}
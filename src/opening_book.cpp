@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "engine.h"
+#include "generator.h"
+
+/**
+ * Opening book generator.
+ *
+ * For every configuration read from stdin as "rows columns mine_count min_dist", it generates many maps with
+ * GenerateMap(), visits the start grid of each, and then measures every candidate guess that is still unknown: how often
+ * it is a mine, and how many grids it reveals otherwise. Candidates are given relative to the start grid (within three
+ * rows and columns) and relative to the four corners of the board (the 2 x 2 block of each corner).
+ *
+ * The best candidates of each configuration, the safest first and the most revealing among equally safe ones, are
+ * printed as brace-initialized entries {rows, columns, mine_count, count, {{anchor, dr, dc, safe_permille}, ...}}. The
+ * table is for studying openings offline; the client does not read it, since its own guesses did at least as well in
+ * every configuration measured.
+ *
+ * Usage: opening_book [--maps N] [--seed S] < configurations
+ */
+
+const int kStartReach = 3;      // Candidates relative to the start grid lie within this many rows and columns
+const int kBookMoves = 8;      // Candidates kept per configuration
+const double kMinSeen = 0.05;  // Candidates unknown after the first visit in fewer maps than this are dropped
+
+// A candidate guess. anchor is 0 for the start grid, or 1-4 for the top-left, top-right, bottom-left and bottom-right
+// corner; dr and dc point from the anchor towards the inside of the board for corners.
+struct Candidate {
+  int anchor, dr, dc;
+  long long seen = 0;      // Maps in which the candidate was still unknown after the first visit
+  long long mines = 0;     // Maps in which it was a mine
+  long long revealed = 0;  // Grids revealed by visiting it, summed over the maps in which it was safe
+};
+
+// Position of a candidate on a board, following the conventions of Candidate
+void Locate(const Candidate &candidate, int rows, int columns, int start_row, int start_column, int &r, int &c) {
+  if (candidate.anchor == 0) {
+    r = start_row + candidate.dr;
+    c = start_column + candidate.dc;
+  } else {
+    bool bottom = candidate.anchor >= 3, right = candidate.anchor % 2 == 0;
+    r = bottom ? rows - 1 - candidate.dr : candidate.dr;
+    c = right ? columns - 1 - candidate.dc : candidate.dc;
+  }
+}
+
+std::vector<Candidate> MakeCandidates() {
+  std::vector<Candidate> candidates;
+  for (int dr = -kStartReach; dr <= kStartReach; dr++) {
+    for (int dc = -kStartReach; dc <= kStartReach; dc++) {
+      if (dr != 0 || dc != 0) candidates.push_back({0, dr, dc});
+    }
+  }
+  for (int anchor = 1; anchor <= 4; anchor++) {
+    for (int dr = 0; dr <= 1; dr++) {
+      for (int dc = 0; dc <= 1; dc++) {
+        candidates.push_back({anchor, dr, dc});
+      }
+    }
+  }
+  return candidates;
+}
+
+void Measure(int rows, int columns, int mine_count, int min_dist, long long maps, std::vector<Candidate> &candidates) {
+  Game game, probe;
+  std::vector<std::string> lines(rows);
+  for (long long k = 0; k < maps; k++) {
+    std::ostringstream oss;
+    std::streambuf *old_output_buffer = std::cout.rdbuf();
+    std::cout.rdbuf(oss.rdbuf());
+    GenerateMap(rows, columns, mine_count, min_dist);
+    std::cout.rdbuf(old_output_buffer);
+    std::istringstream iss(oss.str());
+    int n, m, start_row, start_column;
+    iss >> n >> m;
+    for (std::string &line : lines) {
+      iss >> line;
+    }
+    iss >> start_row >> start_column;
+
+    game.Load(rows, columns, lines.data());
+    game.Visit(start_row, start_column);
+    if (game.state() != 0) continue;
+    for (Candidate &candidate : candidates) {
+      int r, c;
+      Locate(candidate, rows, columns, start_row, start_column, r, c);
+      if (r < 0 || r >= rows || c < 0 || c >= columns || game.visited(r, c)) continue;
+      candidate.seen++;
+      if (lines[r][c] == 'X') {
+        candidate.mines++;
+        continue;
+      }
+      probe = game;
+      probe.Visit(r, c);
+      candidate.revealed += probe.visited_count() - game.visited_count();
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  long long maps = 20000;
+  uint64_t seed = 2025;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--maps") == 0 && i + 1 < argc) {
+      maps = std::atoll(argv[++i]);
+    } else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      seed = std::strtoull(argv[++i], nullptr, 10);
+    } else {
+      std::cerr << "Usage: " << argv[0] << " [--maps N] [--seed S] < configurations" << std::endl;
+      return 1;
+    }
+  }
+
+  int rows, columns, mine_count, min_dist;
+  while (std::cin >> rows >> columns >> mine_count >> min_dist) {
+    InitSeed(seed);
+    std::vector<Candidate> candidates = MakeCandidates();
+    Measure(rows, columns, mine_count, min_dist, maps, candidates);
+    candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                                    [&](const Candidate &candidate) { return candidate.seen < kMinSeen * maps; }),
+                     candidates.end());
+    // Compare mine rates and mean reveals by cross-multiplying, so equal rates compare exactly
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {
+      if (a.mines * b.seen != b.mines * a.seen) return a.mines * b.seen < b.mines * a.seen;
+      return a.revealed * (b.seen - b.mines) > b.revealed * (a.seen - a.mines);
+    });
+    if (static_cast<int>(candidates.size()) > kBookMoves) {
+      candidates.resize(kBookMoves);
+    }
+
+    std::cout << "    {" << rows << ", " << columns << ", " << mine_count << ", " << candidates.size() << ",  // min_dist "
+              << min_dist << "\n     {";
+    for (size_t k = 0; k < candidates.size(); k++) {
+      const Candidate &candidate = candidates[k];
+      int safe_permille = static_cast<int>(1000 * (candidate.seen - candidate.mines) / candidate.seen);
+      std::cout << (k == 0 ? "" : k % 4 == 0 ? ",\n      " : ", ") << "{" << candidate.anchor << ", " << candidate.dr
+                << ", " << candidate.dc << ", " << safe_permille << "}";
+    }
+    std::cout << "}}," << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,236 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "engine.h"
+#include "generator.h"
+#include "server.h"
+
+/**
+ * Differential oracle for the optimized engine.
+ *
+ * It generates random maps with generator.h and random operation sequences, and applies every operation both to the
+ * straightforward server.h and to the Game class of engine.h. After every operation the two states are compared: the
+ * game state, the counters, the visited and marked flags and the map as PrintMap() shows it. At the first divergence
+ * the operation sequence is shrunk while the divergence persists, and the result is printed as a basic.cpp input, so it
+ * can be replayed directly with the server.
+ *
+ * Usage: oracle [--games N] [--seed S]
+ * The exit code is 0 if no divergence was found and 1 otherwise.
+ */
+
+struct Operation {
+  int r, c, type;
+};
+
+// A generated map in the input format of InitMap(), with the start grid chosen by the generator
+struct Scenario {
+  int rows, columns;
+  std::vector<std::string> lines;
+  int start_row, start_column;
+};
+
+Scenario MakeScenario(std::mt19937_64 &rng) {
+  Scenario scenario;
+  int n, m, min_dist, capacity;
+  do {
+    n = Random(3, 30, rng);
+    m = Random(3, 30, rng);
+    min_dist = Random(0, 2, rng);
+    // The generator keeps the blocks within min_dist of the start grid free, so at least this many mines fit
+    capacity = n * m - (2 * min_dist * (min_dist + 1) + 1);
+  } while (capacity < 1);
+  int mine_count = Random(1, capacity, rng);
+  std::ostringstream oss;
+  std::streambuf *old_output_buffer = std::cout.rdbuf();
+  std::cout.rdbuf(oss.rdbuf());
+  GenerateMap(n, m, mine_count, min_dist);
+  std::cout.rdbuf(old_output_buffer);
+  std::istringstream iss(oss.str());
+  iss >> scenario.rows >> scenario.columns;
+  scenario.lines.resize(scenario.rows);
+  for (std::string &line : scenario.lines) {
+    iss >> line;
+  }
+  iss >> scenario.start_row >> scenario.start_column;
+  return scenario;
+}
+
+// Random operations that mostly target useful grids, so the games last long enough to exercise every rule
+std::vector<Operation> MakeOperations(const Scenario &scenario, std::mt19937_64 &rng) {
+  std::vector<Operation> operations{{scenario.start_row, scenario.start_column, 0}};
+  int count = Random(1, 3 * scenario.rows * scenario.columns, rng);
+  for (int k = 0; k < count; k++) {
+    int r = Random(0, scenario.rows - 1, rng), c = Random(0, scenario.columns - 1, rng);
+    int type = Random(0, 2, rng);
+    if (Random(0, 99, rng) == 0) {
+      r = Random(-1, 0, rng) == 0 ? r : -1;
+      c = Random(0, 1, rng) == 0 ? c : scenario.columns;
+    } else if (type != 2) {
+      // Prefer visiting safe grids and marking mines, as a real player would
+      bool want_mine = type == 1;
+      for (int tries = 0; tries < 8 && (scenario.lines[r][c] == 'X') != want_mine; tries++) {
+        r = Random(0, scenario.rows - 1, rng);
+        c = Random(0, scenario.columns - 1, rng);
+      }
+    }
+    operations.push_back({r, c, type});
+  }
+  return operations;
+}
+
+void LoadServer(const Scenario &scenario) {
+  std::ostringstream oss;
+  oss << scenario.rows << " " << scenario.columns << "\n";
+  for (const std::string &line : scenario.lines) {
+    oss << line << "\n";
+  }
+  std::istringstream iss(oss.str());
+  std::streambuf *old_input_buffer = std::cin.rdbuf();
+  std::cin.rdbuf(iss.rdbuf());
+  InitMap();
+  std::cin.rdbuf(old_input_buffer);
+}
+
+// Release the maps allocated by InitMap(), which server.h never frees
+void FreeServer() {
+  for (int i = 0; i < rows; i++) {
+    delete[] game_map[i];
+    delete[] display_map[i];
+    delete[] visited[i];
+    delete[] marked[i];
+  }
+  delete[] game_map;
+  delete[] display_map;
+  delete[] visited;
+  delete[] marked;
+}
+
+void ApplyServer(const Operation &operation) {
+  if (operation.type == 0) {
+    VisitBlock(operation.r, operation.c);
+  } else if (operation.type == 1) {
+    MarkMine(operation.r, operation.c);
+  } else if (operation.type == 2) {
+    AutoExplore(operation.r, operation.c);
+  }
+}
+
+// Describe the first difference between server.h and the engine, or return an empty string if they agree
+std::string Compare(const Game &game) {
+  std::ostringstream diff;
+  if (game.state() != game_state) {
+    diff << "game_state " << game_state << " vs " << game.state();
+  } else if (game.visited_count() != visited_count) {
+    diff << "visited_count " << visited_count << " vs " << game.visited_count();
+  } else if (game.marked_mine_count() != marked_mine_count) {
+    diff << "marked_mine_count " << marked_mine_count << " vs " << game.marked_mine_count();
+  } else if (game.total_mines() != total_mines) {
+    diff << "total_mines " << total_mines << " vs " << game.total_mines();
+  } else {
+    for (int i = 0; i < rows && diff.tellp() == 0; i++) {
+      for (int j = 0; j < columns; j++) {
+        char shown = (game_state == 1 && game_map[i][j] == 'X') ? '@' : display_map[i][j];
+        if (game.Shown(i, j) != shown || game.visited(i, j) != visited[i][j] || game.marked(i, j) != marked[i][j]) {
+          diff << "grid (" << i << ", " << j << ") shows '" << shown << "' vs '" << game.Shown(i, j) << "', visited "
+               << visited[i][j] << " vs " << game.visited(i, j) << ", marked " << marked[i][j] << " vs "
+               << game.marked(i, j);
+          break;
+        }
+      }
+    }
+  }
+  return diff.str();
+}
+
+/**
+ * Replay the operations on both implementations. Returns the index of the first operation after which they differ, or
+ * -1 if they agree throughout. Like basic.cpp, the replay stops when the game ends.
+ */
+int FirstDivergence(Game &game, const Scenario &scenario, const std::vector<Operation> &operations,
+                    std::string &difference) {
+  LoadServer(scenario);
+  game.Load(scenario.rows, scenario.columns, scenario.lines.data());
+  int result = -1;
+  difference = Compare(game);
+  for (int k = 0; k < static_cast<int>(operations.size()) && difference.empty(); k++) {
+    ApplyServer(operations[k]);
+    game.Apply(operations[k].r, operations[k].c, operations[k].type);
+    difference = Compare(game);
+    if (!difference.empty()) {
+      result = k;
+    } else if (game_state != 0) {
+      break;
+    }
+  }
+  FreeServer();
+  return result;
+}
+
+// Drop operations one at a time, from the last to the first, as long as the divergence persists
+std::vector<Operation> Shrink(Game &game, const Scenario &scenario, std::vector<Operation> operations) {
+  std::string difference;
+  operations.resize(FirstDivergence(game, scenario, operations, difference) + 1);
+  for (int k = static_cast<int>(operations.size()) - 1; k >= 0; k--) {
+    std::vector<Operation> candidate = operations;
+    candidate.erase(candidate.begin() + k);
+    int divergence = FirstDivergence(game, scenario, candidate, difference);
+    if (divergence >= 0) {
+      candidate.resize(divergence + 1);
+      operations = candidate;
+      k = std::min(k, static_cast<int>(operations.size()));
+    }
+  }
+  return operations;
+}
+
+int main(int argc, char *argv[]) {
+  long long game_count = 1000;
+  uint64_t seed = 2025;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--games") == 0 && i + 1 < argc) {
+      game_count = std::atoll(argv[++i]);
+    } else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      seed = std::strtoull(argv[++i], nullptr, 10);
+    } else {
+      std::cerr << "Usage: " << argv[0] << " [--games N] [--seed S]" << std::endl;
+      return 1;
+    }
+  }
+
+  InitSeed(seed);
+  std::mt19937_64 rng(seed ^ 0x9e3779b97f4a7c15ULL);
+  Game game;
+  long long operation_count = 0;
+  for (long long g = 0; g < game_count; g++) {
+    Scenario scenario = MakeScenario(rng);
+    std::vector<Operation> operations = MakeOperations(scenario, rng);
+    std::string difference;
+    int divergence = FirstDivergence(game, scenario, operations, difference);
+    operation_count += static_cast<long long>(operations.size());
+    if (divergence < 0 && difference.empty()) {
+      continue;
+    }
+
+    std::cout << "Divergence in game " << g << " (seed " << seed << ") after operation " << divergence << ": "
+              << difference << std::endl;
+    std::vector<Operation> reproducer = Shrink(game, scenario, operations);
+    FirstDivergence(game, scenario, reproducer, difference);
+    std::cout << "Minimal reproducer (" << reproducer.size() << " operations, " << difference << "):" << std::endl;
+    std::cout << scenario.rows << " " << scenario.columns << std::endl;
+    for (const std::string &line : scenario.lines) {
+      std::cout << line << std::endl;
+    }
+    for (const Operation &operation : reproducer) {
+      std::cout << operation.r << " " << operation.c << " " << operation.type << std::endl;
+    }
+    return 1;
+  }
+  std::cout << game_count << " games, " << operation_count << " operations generated, no divergence" << std::endl;
+  return 0;
+}